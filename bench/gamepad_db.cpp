@@ -0,0 +1,97 @@
+
+// Gamepad db startup benchmark
+//
+// What loading gamecontrollerdb.txt costs before the first frame. The old
+// way (ifstream, copied into a stringstream, copied again into a string,
+// then all of it handed to SetGamepadMappings) against mapping it and
+// building the GUID index (see vendor/afterhours/src/plugins/gamepad_db.h),
+// with the index scanned from the text and read from a sidecar. Then the
+// lookup + register a connected gamepad pays instead.
+//
+// GLFW parsing what it gets cant be timed without a window, so the bytes
+// handed to it are printed too, that part goes down with them.
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "rl.h"
+
+#define AFTER_HOURS_ENTITY_HELPER
+#define AFTER_HOURS_SYSTEM
+#include "afterhours/ah.h"
+#include "afterhours/bench/bench.h"
+#include "afterhours/src/plugins/gamepad_db.h"
+
+using namespace afterhours;
+
+// src/main.cpp before the gamepad db
+static size_t load_everything(const char *path) {
+  std::ifstream ifs(path);
+  std::stringstream buffer;
+  buffer << ifs.rdbuf();
+  std::string mappings = buffer.str();
+  input::set_gamepad_mappings(mappings.c_str());
+  return mappings.size();
+}
+
+int main(int argc, char **argv) {
+  const char *path = argc > 1 ? argv[1] : "gamecontrollerdb.txt";
+  const char *index_path = "gamepad_db_bench.idx";
+
+  gamepad_db::Database db;
+  if (!db.open(path)) {
+    std::cout << "couldnt open " << path << std::endl;
+    return 1;
+  }
+  if (!db.write_index(index_path)) {
+    std::cout << "couldnt write " << index_path << std::endl;
+    return 1;
+  }
+  std::cout << path << ": " << db.file.size << " bytes, "
+            << db.entries.size() << " " << gamepad_db::current_platform()
+            << " mappings, index is " << db.entries.size() *
+                                             sizeof(gamepad_db::Entry)
+            << " bytes" << std::endl;
+
+  size_t sink = 0;
+  const int iterations = 500;
+  double before = bench::run("startup: ifstream + stringstream + string", 1,
+                             iterations, [&]() { sink += load_everything(path); });
+  double scanned = bench::run("startup: mmap + scan index", 1, iterations, [&]() {
+    gamepad_db::Database fresh;
+    fresh.open(path);
+    sink += fresh.entries.size();
+  });
+  double sidecar =
+      bench::run("startup: mmap + sidecar index", 1, iterations, [&]() {
+        gamepad_db::Database fresh;
+        fresh.open(path, index_path);
+        sink += fresh.entries.size() + fresh.from_sidecar;
+      });
+
+  // every guid in the db, the way glfwGetJoystickGUID hands them over
+  std::vector<std::string> guids;
+  size_t line_bytes = 0;
+  for (const gamepad_db::Entry &entry : db.entries) {
+    guids.emplace_back(db.file.data + entry.offset, 32);
+    line_bytes += entry.length;
+  }
+  size_t next = 0;
+  bench::run("connect: find + register one mapping", 1, 200'000, [&]() {
+    std::string_view line = db.find(guids[next++ % guids.size()]);
+    input::set_gamepad_mappings(std::string(line).c_str());
+    sink += line.size();
+  });
+
+  std::printf("startup %.1fx faster scanned, %.1fx with the sidecar\n",
+              before / scanned, before / sidecar);
+  std::printf("bytes handed to SetGamepadMappings: %zu at startup before, "
+              "%zu per connected gamepad after\n",
+              db.file.size, line_bytes / db.entries.size());
+
+  bench::do_not_optimize(sink);
+  std::remove(index_path);
+  return 0;
+}
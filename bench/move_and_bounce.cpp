@@ -0,0 +1,266 @@
+
+// MoveAndBounce benchmark
+//
+// The game's one entity at a time MoveAndBounce (System<> + vec2 operators)
+// against bounce::move_and_bounce (src/bounce_kernel.h) run over arrays
+// copied from the same world, at 1k, 10k and 100k balls (a tenth of them
+// pinned like paddles). Afterwards every position, velocity and score has to
+// match bit for bit. The kernel is also timed scalar against SIMD.
+//
+// The arrays are the kernel's own, the pools dont keep Transform and
+// HasVelocity lined up, so this is an upper bound on what the game would get
+// and only an experiment, the game keeps the plain System.
+
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "rl.h"
+
+// same storage as the game
+#define AFTER_HOURS_USE_SPARSE_SET_STORAGE
+#define AFTER_HOURS_ENTITY_HELPER
+#define AFTER_HOURS_ENTITY_QUERY
+#define AFTER_HOURS_SYSTEM
+#include "afterhours/ah.h"
+#include "afterhours/bench/bench.h"
+#include "bounce_kernel.h"
+
+using namespace afterhours;
+using vec2 = raylib::Vector2;
+
+constexpr float map_width = 1280.f;
+constexpr float map_height = 720.f;
+constexpr float dt = 1.f / 120.f;
+
+struct Transform : BaseComponent {
+  vec2 position;
+  vec2 size;
+  Transform(vec2 pos, vec2 sz) : position(pos), size(sz) {}
+};
+
+struct HasVelocity : BaseComponent {
+  vec2 vel;
+};
+
+struct Pinned : BaseComponent {};
+
+struct Score {
+  int left = 0;
+  int right = 0;
+};
+
+// Same as MoveAndBounce in main.cpp
+struct MoveOneAtATime : System<Transform, HasVelocity> {
+  Score score;
+
+  virtual void for_each_with(Entity &entity, Transform &transform,
+                             HasVelocity &vel, float delta) override {
+    float sz = 500;
+    vec2 p = transform.position;
+    p += vel.vel * sz * delta;
+
+    if (p.y < 0 || p.y + transform.size.y > map_height) {
+      if (entity.has<Pinned>())
+        return;
+
+      vel.vel.y *= -1;
+      p += vel.vel * sz * delta;
+      p += vel.vel * sz * delta;
+    }
+
+    if (p.x < -10 || p.x > map_width + 10) {
+      if (p.x < -10)
+        score.right++;
+      else
+        score.left++;
+      p = vec2{map_width / 2.f, map_height / 2.f};
+      vel.vel = {0, 0};
+    }
+
+    transform.position = p;
+  }
+};
+
+// xorshift, so both worlds (and every run) get the same balls
+struct Random {
+  uint32_t state = 2463534242u;
+  float next(float lo, float hi) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return lo + (hi - lo) * (float)(state % 100'000) / 100'000.f;
+  }
+};
+
+static void make_balls(size_t count) {
+  Random random;
+  for (size_t i = 0; i < count; i++) {
+    Entity &entity = EntityHelper::createEntity();
+    entity.addComponent<Transform>(
+        vec2{random.next(-5.f, map_width + 5.f),
+             random.next(0.f, map_height - 30.f)},
+        vec2{30.f, i % 10 == 0 ? 150.f : 30.f});
+    entity.addComponent<HasVelocity>().vel =
+        vec2{random.next(-1.f, 1.f), random.next(-1.f, 1.f)};
+    if (i % 10 == 0)
+      entity.addComponent<Pinned>();
+  }
+}
+
+static bool same_bits(float a, float b) {
+  return std::memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+// the kernel's view of a world, one entry per entity in get_entities() order
+struct Columns {
+  std::vector<float> x, y, vx, vy, height, pinned;
+
+  void copy_from_world() {
+    for (const auto &entity : EntityHelper::get_entities()) {
+      const Transform &transform = entity->get<Transform>();
+      x.push_back(transform.position.x);
+      y.push_back(transform.position.y);
+      height.push_back(transform.size.y);
+      vx.push_back(entity->get<HasVelocity>().vel.x);
+      vy.push_back(entity->get<HasVelocity>().vel.y);
+      pinned.push_back(entity->has<Pinned>() ? 1.f : 0.f);
+    }
+  }
+
+  bounce::Batch batch() {
+    return bounce::Batch{.x = x.data(),
+                         .y = y.data(),
+                         .vx = vx.data(),
+                         .vy = vy.data(),
+                         .height = height.data(),
+                         .pinned = pinned.data(),
+                         .count = x.size()};
+  }
+
+  bool matches_world() const {
+    const Entities &entities = EntityHelper::get_entities();
+    if (entities.size() != x.size())
+      return false;
+    for (size_t i = 0; i < entities.size(); i++) {
+      vec2 position = entities[i]->get<Transform>().position;
+      vec2 vel = entities[i]->get<HasVelocity>().vel;
+      if (!same_bits(position.x, x[i]) || !same_bits(position.y, y[i]) ||
+          !same_bits(vel.x, vx[i]) || !same_bits(vel.y, vy[i]))
+        return false;
+    }
+    return true;
+  }
+};
+
+static bool run_systems(size_t count) {
+  World world;
+  WorldScope bound = world.scope();
+  make_balls(count);
+  auto system = std::make_unique<MoveOneAtATime>();
+  MoveOneAtATime *scalar_system = system.get();
+  world.systems.register_update_system(std::move(system));
+
+  Columns columns;
+  columns.copy_from_world();
+  bounce::Batch batch = columns.batch();
+  bounce::Params params{.speed = 500.f,
+                        .dt = dt,
+                        .map_width = map_width,
+                        .map_height = map_height};
+  Score score;
+
+  int iterations = (int)(20'000'000 / count);
+  std::string scalar_name =
+      "System one at a time " + std::to_string(count);
+  std::string kernel_name = "kernel SIMD on arrays " + std::to_string(count);
+  bench::run(scalar_name.c_str(), count, iterations,
+             [&]() { world.tick(dt); });
+  bench::run(kernel_name.c_str(), count, iterations, [&]() {
+    bounce::Exits exits = bounce::move_and_bounce(batch, params);
+    score.right += exits.past_left;
+    score.left += exits.past_right;
+  });
+
+  bool match = columns.matches_world() &&
+               scalar_system->score.left == score.left &&
+               scalar_system->score.right == score.right;
+  std::cout << "   score " << score.left << "/" << score.right << ", "
+            << (match ? "bit identical" : "MISMATCH") << std::endl;
+  return match;
+}
+
+static bool run_kernel(size_t count) {
+  Random random;
+  std::vector<float> x(count), y(count), vx(count), vy(count);
+  std::vector<float> height(count), pinned(count);
+  for (size_t i = 0; i < count; i++) {
+    x[i] = random.next(-5.f, map_width + 5.f);
+    y[i] = random.next(0.f, map_height - 30.f);
+    vx[i] = random.next(-1.f, 1.f);
+    vy[i] = random.next(-1.f, 1.f);
+    height[i] = i % 10 == 0 ? 150.f : 30.f;
+    pinned[i] = i % 10 == 0 ? 1.f : 0.f;
+  }
+  std::vector<float> sx = x, sy = y, svx = vx, svy = vy;
+
+  bounce::Params params{.speed = 500.f,
+                        .dt = dt,
+                        .map_width = map_width,
+                        .map_height = map_height};
+  bounce::Batch simd{.x = x.data(),
+                     .y = y.data(),
+                     .vx = vx.data(),
+                     .vy = vy.data(),
+                     .height = height.data(),
+                     .pinned = pinned.data(),
+                     .count = count};
+  bounce::Batch scalar = simd;
+  scalar.x = sx.data();
+  scalar.y = sy.data();
+  scalar.vx = svx.data();
+  scalar.vy = svy.data();
+
+  int iterations = (int)(50'000'000 / count);
+  bounce::Exits scalar_exits;
+  bounce::Exits simd_exits;
+  std::string scalar_name = "kernel scalar " + std::to_string(count);
+  std::string simd_name = "kernel SIMD " + std::to_string(count);
+  bench::run(scalar_name.c_str(), count, iterations, [&]() {
+    bounce::Exits exits = bounce::move_and_bounce_scalar(scalar, params);
+    scalar_exits.past_left += exits.past_left;
+    scalar_exits.past_right += exits.past_right;
+  });
+  bench::run(simd_name.c_str(), count, iterations, [&]() {
+    bounce::Exits exits = bounce::move_and_bounce(simd, params);
+    simd_exits.past_left += exits.past_left;
+    simd_exits.past_right += exits.past_right;
+  });
+
+  bool match = scalar_exits.past_left == simd_exits.past_left &&
+               scalar_exits.past_right == simd_exits.past_right &&
+               std::memcmp(x.data(), sx.data(), count * sizeof(float)) == 0 &&
+               std::memcmp(y.data(), sy.data(), count * sizeof(float)) == 0 &&
+               std::memcmp(vx.data(), svx.data(), count * sizeof(float)) ==
+                   0 &&
+               std::memcmp(vy.data(), svy.data(), count * sizeof(float)) == 0;
+  std::cout << "   " << (match ? "bit identical" : "MISMATCH") << std::endl;
+  return match;
+}
+
+int main(int, char **) {
+#if defined(__AVX__)
+  std::cout << "kernel uses AVX" << std::endl;
+#elif defined(__SSE2__)
+  std::cout << "kernel uses SSE2" << std::endl;
+#else
+  std::cout << "kernel is scalar only" << std::endl;
+#endif
+
+  bool ok = true;
+  for (size_t count : {1'000, 10'000, 100'000})
+    ok = run_kernel(count) && ok;
+  for (size_t count : {1'000, 10'000, 100'000})
+    ok = run_systems(count) && ok;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,217 @@
+
+#pragma once
+
+#include <cstddef>
+
+#if defined(__SSE2__) || defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+// The math behind MoveAndBounce, on arrays so it can go 4 (SSE) or 8 (AVX)
+// entities at a time. Only bench/move_and_bounce.cpp uses it, the game
+// cant hand it the components without copying them first (see the comment
+// on MoveAndBounce in main.cpp).
+//
+// Every path does the same float operations in the same order as the
+// original vec2 version: the step is (vel * speed) * dt, a bounce flips
+// vel.y and adds the new step twice. No fma, so the SIMD paths match
+// move_one() bit for bit. (The scalar path could still get contracted into
+// fma by -ffast-math/-ffp-contract=fast with an FMA -march, dont.)
+namespace bounce {
+
+struct Params {
+  float speed = 500.f;
+  float dt = 0.f;
+  float map_width = 0.f;
+  float map_height = 0.f;
+};
+
+// One entry per entity. `pinned` is 1.f for paddles, they dont bounce and
+// dont move at all on a step that would take them off the top/bottom
+struct Batch {
+  float *x = nullptr;
+  float *y = nullptr;
+  float *vx = nullptr;
+  float *vy = nullptr;
+  const float *height = nullptr;
+  const float *pinned = nullptr;
+  size_t count = 0;
+};
+
+// How many went off each side this step (and got put back in the middle)
+struct Exits {
+  int past_left = 0;
+  int past_right = 0;
+};
+
+inline void move_one(const Batch &batch, size_t i, const Params &params,
+                     Exits &exits) {
+  float x = batch.x[i] + batch.vx[i] * params.speed * params.dt;
+  float y = batch.y[i] + batch.vy[i] * params.speed * params.dt;
+
+  if (y < 0 || y + batch.height[i] > params.map_height) {
+    if (batch.pinned[i] != 0.f)
+      return;
+    batch.vy[i] *= -1;
+    for (int twice = 0; twice < 2; twice++) {
+      x += batch.vx[i] * params.speed * params.dt;
+      y += batch.vy[i] * params.speed * params.dt;
+    }
+  }
+
+  if (x < -10 || x > params.map_width + 10) {
+    if (x < -10)
+      exits.past_left++;
+    else
+      exits.past_right++;
+    x = params.map_width / 2.f;
+    y = params.map_height / 2.f;
+    batch.vx[i] = 0;
+    batch.vy[i] = 0;
+  }
+
+  batch.x[i] = x;
+  batch.y[i] = y;
+}
+
+#if defined(__SSE2__)
+struct Sse {
+  using F = __m128;
+  static constexpr size_t width = 4;
+  static F load(const float *p) { return _mm_loadu_ps(p); }
+  static void store(float *p, F v) { _mm_storeu_ps(p, v); }
+  static F set1(float f) { return _mm_set1_ps(f); }
+  static F add(F a, F b) { return _mm_add_ps(a, b); }
+  static F mul(F a, F b) { return _mm_mul_ps(a, b); }
+  static F lt(F a, F b) { return _mm_cmplt_ps(a, b); }
+  static F gt(F a, F b) { return _mm_cmpgt_ps(a, b); }
+  static F ne(F a, F b) { return _mm_cmpneq_ps(a, b); }
+  static F bor(F a, F b) { return _mm_or_ps(a, b); }
+  static F band(F a, F b) { return _mm_and_ps(a, b); }
+  // ~a & b
+  static F andnot(F a, F b) { return _mm_andnot_ps(a, b); }
+  // mask ? a : b
+  static F select(F mask, F a, F b) {
+    return bor(band(mask, a), andnot(mask, b));
+  }
+  static float sum(F v) {
+    alignas(16) float lanes[width];
+    _mm_store_ps(lanes, v);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  }
+};
+#endif
+
+#if defined(__AVX__)
+struct Avx {
+  using F = __m256;
+  static constexpr size_t width = 8;
+  static F load(const float *p) { return _mm256_loadu_ps(p); }
+  static void store(float *p, F v) { _mm256_storeu_ps(p, v); }
+  static F set1(float f) { return _mm256_set1_ps(f); }
+  static F add(F a, F b) { return _mm256_add_ps(a, b); }
+  static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+  static F lt(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+  static F gt(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+  static F ne(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_NEQ_UQ); }
+  static F bor(F a, F b) { return _mm256_or_ps(a, b); }
+  static F band(F a, F b) { return _mm256_and_ps(a, b); }
+  static F andnot(F a, F b) { return _mm256_andnot_ps(a, b); }
+  static F select(F mask, F a, F b) { return _mm256_blendv_ps(b, a, mask); }
+  static float sum(F v) {
+    return Sse::sum(_mm_add_ps(_mm256_castps256_ps128(v),
+                               _mm256_extractf128_ps(v, 1)));
+  }
+};
+#endif
+
+// move_one() for L::width entities at a time, starting at `i`. Returns where
+// it stopped, what is left is less than one full vector
+template <typename L>
+size_t move_lanes(const Batch &batch, size_t i, const Params &params,
+                  Exits &exits) {
+  using F = typename L::F;
+  const F speed = L::set1(params.speed);
+  const F dt = L::set1(params.dt);
+  const F zero = L::set1(0.f);
+  const F minus_one = L::set1(-1.f);
+  const F map_height = L::set1(params.map_height);
+  const F left_edge = L::set1(-10.f);
+  const F right_edge = L::set1(params.map_width + 10);
+  const F center_x = L::set1(params.map_width / 2.f);
+  const F center_y = L::set1(params.map_height / 2.f);
+  const F one = L::set1(1.f);
+  // counted per lane as floats so there is no movemask + popcount in the
+  // loop, exact as long as a lane sees less than 2^24 of them
+  F past_left_count = zero;
+  F past_right_count = zero;
+
+  for (; i + L::width <= batch.count; i += L::width) {
+    F x0 = L::load(batch.x + i);
+    F y0 = L::load(batch.y + i);
+    F vx = L::load(batch.vx + i);
+    F vy0 = L::load(batch.vy + i);
+
+    F x = L::add(x0, L::mul(L::mul(vx, speed), dt));
+    F y = L::add(y0, L::mul(L::mul(vy0, speed), dt));
+
+    F hit = L::bor(L::lt(y, zero),
+                   L::gt(L::add(y, L::load(batch.height + i)), map_height));
+    F pinned = L::ne(L::load(batch.pinned + i), zero);
+    // pinned lanes that hit keep everything as it was
+    F stuck = L::band(hit, pinned);
+    F bounce = L::andnot(pinned, hit);
+
+    F vy = L::select(bounce, L::mul(vy0, minus_one), vy0);
+    F step_x = L::mul(L::mul(vx, speed), dt);
+    F step_y = L::mul(L::mul(vy, speed), dt);
+    x = L::select(bounce, L::add(L::add(x, step_x), step_x), x);
+    y = L::select(bounce, L::add(L::add(y, step_y), step_y), y);
+
+    F past_left = L::andnot(stuck, L::lt(x, left_edge));
+    F past_right =
+        L::andnot(stuck, L::andnot(past_left, L::gt(x, right_edge)));
+    F out = L::bor(past_left, past_right);
+    past_left_count = L::add(past_left_count, L::band(past_left, one));
+    past_right_count = L::add(past_right_count, L::band(past_right, one));
+
+    x = L::select(out, center_x, x);
+    y = L::select(out, center_y, y);
+    vx = L::select(out, zero, vx);
+    vy = L::select(out, zero, vy);
+
+    L::store(batch.x + i, L::select(stuck, x0, x));
+    L::store(batch.y + i, L::select(stuck, y0, y));
+    L::store(batch.vx + i, vx);
+    L::store(batch.vy + i, vy);
+  }
+  exits.past_left += (int)L::sum(past_left_count);
+  exits.past_right += (int)L::sum(past_right_count);
+  return i;
+}
+
+inline Exits move_and_bounce_scalar(const Batch &batch,
+                                    const Params &params) {
+  Exits exits;
+  for (size_t i = 0; i < batch.count; i++)
+    move_one(batch, i, params, exits);
+  return exits;
+}
+
+// Widest vectors the build allows (AVX needs -mavx or an -march that has
+// it, SSE2 is always there on x86-64), then scalar for the leftovers
+inline Exits move_and_bounce(const Batch &batch, const Params &params) {
+  Exits exits;
+  size_t i = 0;
+#if defined(__AVX__)
+  i = move_lanes<Avx>(batch, i, params, exits);
+#endif
+#if defined(__SSE2__)
+  i = move_lanes<Sse>(batch, i, params, exits);
+#endif
+  for (; i < batch.count; i++)
+    move_one(batch, i, params, exits);
+  return exits;
+}
+
+} // namespace bounce
@@ -0,0 +1,95 @@
+
+#pragma once
+
+// Just enough of raylib for the simulation to build without it.
+// Used when PONG_HEADLESS is defined (see `make headless`), nothing in here
+// draws or reads devices, the afterhours plugins use their non raylib
+// fallbacks in that mode.
+
+namespace raylib {
+
+struct Vector2 {
+  float x;
+  float y;
+};
+
+struct Vector3 {
+  float x;
+  float y;
+  float z;
+};
+
+struct Vector4 {
+  float x;
+  float y;
+  float z;
+  float w;
+};
+
+struct Rectangle {
+  float x;
+  float y;
+  float width;
+  float height;
+};
+
+struct Color {
+  unsigned char r;
+  unsigned char g;
+  unsigned char b;
+  unsigned char a;
+};
+
+inline Vector2 operator+(const Vector2 &a, const Vector2 &b) {
+  return Vector2{a.x + b.x, a.y + b.y};
+}
+inline Vector2 operator-(const Vector2 &a, const Vector2 &b) {
+  return Vector2{a.x - b.x, a.y - b.y};
+}
+inline Vector2 operator*(const Vector2 &a, float f) {
+  return Vector2{a.x * f, a.y * f};
+}
+inline Vector2 operator*(float f, const Vector2 &a) { return a * f; }
+inline Vector2 &operator+=(Vector2 &a, const Vector2 &b) {
+  a = a + b;
+  return a;
+}
+inline Vector2 &operator-=(Vector2 &a, const Vector2 &b) {
+  a = a - b;
+  return a;
+}
+inline Vector2 &operator*=(Vector2 &a, float f) {
+  a = a * f;
+  return a;
+}
+
+// same values as raylib.h
+enum KeyboardKey {
+  KEY_NULL = 0,
+  KEY_SPACE = 32,
+  KEY_RIGHT = 262,
+  KEY_LEFT = 263,
+  KEY_DOWN = 264,
+  KEY_UP = 265,
+};
+
+enum GamepadButton {
+  GAMEPAD_BUTTON_UNKNOWN = 0,
+  GAMEPAD_BUTTON_LEFT_FACE_UP,
+  GAMEPAD_BUTTON_LEFT_FACE_RIGHT,
+  GAMEPAD_BUTTON_LEFT_FACE_DOWN,
+  GAMEPAD_BUTTON_LEFT_FACE_LEFT,
+  GAMEPAD_BUTTON_RIGHT_FACE_UP,
+  GAMEPAD_BUTTON_RIGHT_FACE_RIGHT,
+  GAMEPAD_BUTTON_RIGHT_FACE_DOWN,
+  GAMEPAD_BUTTON_RIGHT_FACE_LEFT,
+};
+
+enum GamepadAxis {
+  GAMEPAD_AXIS_LEFT_X = 0,
+  GAMEPAD_AXIS_LEFT_Y = 1,
+  GAMEPAD_AXIS_RIGHT_X = 2,
+  GAMEPAD_AXIS_RIGHT_Y = 3,
+};
+
+} // namespace raylib
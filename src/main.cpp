@@ -11,14 +11,27 @@ backward::SignalHandling sh;
 #include "rl.h"
 
 #define AFTER_HOURS_INCLUDE_DERIVED_CHILDREN
+#define AFTER_HOURS_USE_SPARSE_SET_STORAGE
 #define AFTER_HOURS_ENTITY_HELPER
 #define AFTER_HOURS_ENTITY_QUERY
 #define AFTER_HOURS_SYSTEM
 #include "afterhours/ah.h"
+#include "afterhours/src/allocation_hooks.h"
+#if !defined(PONG_HEADLESS)
 #define AFTER_HOURS_USE_RAYLIB
+#endif
 #include "afterhours/src/developer.h"
+#include "afterhours/src/plugins/collision.h"
 #include "afterhours/src/plugins/input_system.h"
+#if !defined(PONG_HEADLESS)
+#include "afterhours/src/plugins/gamepad_db.h"
+#endif
+#include "afterhours/src/plugins/profiling.h"
+#include "afterhours/src/plugins/render_commands.h"
 #include "afterhours/src/plugins/window_manager.h"
+#if defined(PONG_HEADLESS)
+#include "afterhours/src/thread_pool.h"
+#endif
 #include <cassert>
 
 //
@@ -41,6 +54,7 @@ template <class... Ts> struct overloaded : Ts... {
 template <typename T> int sgn(T val) { return (T(0) < val) - (val < T(0)); }
 } // namespace myutil
 
+#if !defined(PONG_HEADLESS)
 struct RenderFPS : System<window_manager::ProvidesCurrentResolution> {
   virtual ~RenderFPS() {}
   virtual void for_each_with(
@@ -50,6 +64,7 @@ struct RenderFPS : System<window_manager::ProvidesCurrentResolution> {
     raylib::DrawFPS((int)(pCurrentResolution.width() - 80), 0);
   }
 };
+#endif
 
 const vec2 button_size = vec2{100, 50};
 
@@ -64,30 +79,32 @@ using afterhours::input;
 
 auto get_mapping() {
   std::map<InputAction, input::ValidInputs> mapping;
+  // Note: the casts are no-ops with raylib, but in the headless build
+  // the gamepad types are afterhours' own enums
   mapping[InputAction::PaddleUp] = {
       raylib::KEY_UP,
       input::GamepadAxisWithDir{
-          .axis = raylib::GAMEPAD_AXIS_LEFT_Y,
+          .axis = input::GamepadAxis(raylib::GAMEPAD_AXIS_LEFT_Y),
           .dir = -1,
       },
-      raylib::GAMEPAD_BUTTON_LEFT_FACE_UP,
+      input::GamepadButton(raylib::GAMEPAD_BUTTON_LEFT_FACE_UP),
   };
 
   mapping[InputAction::PaddleDown] = {
       raylib::KEY_DOWN,
       input::GamepadAxisWithDir{
-          .axis = raylib::GAMEPAD_AXIS_LEFT_Y,
+          .axis = input::GamepadAxis(raylib::GAMEPAD_AXIS_LEFT_Y),
           .dir = 1,
       },
-      raylib::GAMEPAD_BUTTON_LEFT_FACE_DOWN,
+      input::GamepadButton(raylib::GAMEPAD_BUTTON_LEFT_FACE_DOWN),
   };
 
   mapping[InputAction::Launch] = {
       raylib::KEY_SPACE,
-      raylib::GAMEPAD_BUTTON_RIGHT_FACE_UP,
-      raylib::GAMEPAD_BUTTON_RIGHT_FACE_DOWN,
-      raylib::GAMEPAD_BUTTON_RIGHT_FACE_LEFT,
-      raylib::GAMEPAD_BUTTON_RIGHT_FACE_RIGHT,
+      input::GamepadButton(raylib::GAMEPAD_BUTTON_RIGHT_FACE_UP),
+      input::GamepadButton(raylib::GAMEPAD_BUTTON_RIGHT_FACE_DOWN),
+      input::GamepadButton(raylib::GAMEPAD_BUTTON_RIGHT_FACE_LEFT),
+      input::GamepadButton(raylib::GAMEPAD_BUTTON_RIGHT_FACE_RIGHT),
   };
   return mapping;
 }
@@ -124,8 +141,51 @@ struct PlayerID : BaseComponent {
   PlayerID(input::GamepadID i) : id(i) {}
 };
 
+// Paddles with this are driven by AIPaddleInput instead of a person. With
+// the defaults it never misses, reaction and aim_error make it beatable
+struct AIControlled : BaseComponent {
+  // seconds between looks at the ball, in between it goes for where the
+  // ball was the last time it looked
+  float reaction = 0.f;
+  // every look is off by up to this many pixels either way
+  float aim_error = 0.f;
+
+  // kept here and not in the system so a rollback puts them back too
+  uint32_t rng = 1;
+  float until_look = 0.f;
+  float target_y = 0.f;
+
+  AIControlled() = default;
+  AIControlled(float reaction_, float aim_error_, uint32_t seed)
+      : reaction(reaction_), aim_error(aim_error_) {
+    reseed(seed);
+  }
+
+  // xorshift cant start from 0
+  void reseed(uint32_t seed) {
+    rng = (seed * 2654435761u) ^ 0x9e3779b9u;
+    if (rng == 0)
+      rng = 1;
+  }
+
+  // -1 to 1
+  float next_error() {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return (float)(rng >> 8) / (float)(1u << 23) - 1.f;
+  }
+};
+
+struct ProvidesScore : BaseComponent {
+  int left = 0;
+  int right = 0;
+};
+
 struct ImpulseBall : System<HasVelocity> {
 
+  ImpulseBall() { reads<PlayerID, input::InputCollector<InputAction>>(); }
+
   virtual void for_each_with(Entity &entity, HasVelocity &vel, float) override {
     if (entity.has<PlayerID>())
       return;
@@ -154,23 +214,29 @@ struct ImpulseBall : System<HasVelocity> {
   }
 };
 
+// One entity at a time on purpose. bench/move_and_bounce.cpp runs the same
+// math over arrays, but the pools dont line Transform and HasVelocity up so
+// the game would have to copy into them and back, which comes out slower at
+// 100k balls (`make bench_move`)
 struct MoveAndBounce : System<Transform, HasVelocity> {
   float map_width;
   float map_height;
+  ProvidesScore *score = nullptr;
 
-  void once(float) {
-    auto &rez_manager =
-        EntityQuery()
-            .whereHasComponent<window_manager::ProvidesCurrentResolution>()
-            .gen_first_enforce();
+  MoveAndBounce() {
+    reads<PlayerID, window_manager::ProvidesCurrentResolution>();
+    writes<ProvidesScore>();
+  }
 
+  void once(float) {
     window_manager::ProvidesCurrentResolution &pCurrentResolution =
-        rez_manager.get<window_manager::ProvidesCurrentResolution>();
+        *EntityHelper::get_singleton_cmp<
+            window_manager::ProvidesCurrentResolution>();
 
     map_width = (float)pCurrentResolution.width();
     map_height = (float)pCurrentResolution.height();
 
-    // TODO get score singleton
+    score = EntityHelper::get_singleton_cmp<ProvidesScore>();
   }
   virtual void for_each_with(Entity &entity, Transform &transform,
                              HasVelocity &vel, float dt) override {
@@ -189,19 +255,24 @@ struct MoveAndBounce : System<Transform, HasVelocity> {
     }
 
     if (p.x < -10 || p.x > map_width + 10) {
+      if (p.x < -10)
+        score->right++;
+      else
+        score->left++;
       p = vec2{map_width / 2.f, map_height / 2.f};
       vel.vel = {0, 0};
-      // TODO add to score
     }
 
     transform.update(p);
   }
 };
 
-struct ImpulsePaddle : System<HasVelocity, PlayerID> {
+struct ImpulsePaddle : System<HasVelocity, const PlayerID> {
 
-  virtual void for_each_with(Entity &, HasVelocity &vel, PlayerID &playerID,
-                             float) override {
+  ImpulsePaddle() { reads<input::InputCollector<InputAction>>(); }
+
+  virtual void for_each_with(Entity &, HasVelocity &vel,
+                             const PlayerID &playerID, float) override {
 
     input::PossibleInputCollector<InputAction> inpc =
         input::get_input_collector<InputAction>();
@@ -237,6 +308,72 @@ struct ImpulsePaddle : System<HasVelocity, PlayerID> {
   }
 };
 
+struct AIPaddleInput
+    : System<const Transform, const PlayerID, AIControlled> {
+  // how far off center the ball can be before we bother moving
+  float deadzone = 20.f;
+
+  bool has_ball = false;
+  float ball_y = 0.f;
+  bool ball_waiting = false;
+
+  // looks at the ball in once() and presses buttons like a player would
+  AIPaddleInput() {
+    reads<HasVelocity>();
+    writes<input::InputCollector<InputAction>>();
+  }
+
+  void once(float) {
+    OptEntity ball = StaticQuery<query::With<HasVelocity>,
+                                 query::Without<PlayerID>>()
+                         .first();
+    has_ball = ball.valid();
+    if (!has_ball)
+      return;
+    const Transform &transform = ball->get<Transform>();
+    const HasVelocity &vel = ball->get<HasVelocity>();
+    ball_y = transform.position.y + transform.size.y / 2.f;
+    ball_waiting = vel.vel.x == 0.f && vel.vel.y == 0.f;
+  }
+
+  virtual void for_each_with(Entity &, const Transform &transform,
+                             const PlayerID &playerID, AIControlled &ai,
+                             float dt) override {
+    input::PossibleInputCollector<InputAction> inpc =
+        input::get_input_collector<InputAction>();
+    if (!inpc.has_value() || !has_ball) {
+      return;
+    }
+
+    auto press = [&](InputAction action) {
+      inpc.inputs().push_back(
+          input::ActionDone<InputAction>{.medium = input::DeviceMedium::None,
+                                         .id = playerID.id,
+                                         .action = action,
+                                         .amount_pressed = 1.f,
+                                         .length_pressed = dt});
+    };
+
+    ai.until_look -= dt;
+    if (ai.until_look <= 0.f) {
+      ai.until_look = ai.reaction;
+      ai.target_y = ball_y + ai.aim_error * ai.next_error();
+    }
+
+    float diff =
+        ai.target_y - (transform.position.y + transform.size.y / 2.f);
+    if (diff < -deadzone) {
+      press(InputAction::PaddleUp);
+    } else if (diff > deadzone) {
+      press(InputAction::PaddleDown);
+    }
+
+    if (ball_waiting) {
+      press(InputAction::Launch);
+    }
+  }
+};
+
 using raylib::Rectangle;
 struct EQ : public EntityQuery<EQ> {
   struct WhereInRange : EntityQuery::Modification {
@@ -286,31 +423,56 @@ struct EQ : public EntityQuery<EQ> {
   EQ &whereOverlaps(const Rectangle r) { return add_mod(new WhereOverlaps(r)); }
 };
 
-struct Collide : System<Transform, HasVelocity> {
-  virtual void for_each_with(Entity &entity, Transform &transform,
-                             HasVelocity &hasVel, float) override {
-    // only worry about those that can flip
-
-    auto colliders = EQ().whereNotID(entity.id)
-                         .whereHasComponent<Transform>()
-                         .whereOverlaps(transform.rect())
-                         .gen();
-    if (colliders.size() == 0)
-      return;
+struct Collide : System<collision::ProvidesBroadphase> {
+  // reused every frame so we dont allocate
+  std::vector<Entity *> hit;
+
+  Collide() { writes<HasVelocity>(); }
 
-    hasVel.vel = hasVel.vel * -1.f;
+  virtual void for_each_with(Entity &,
+                             collision::ProvidesBroadphase &broadphase,
+                             float) override {
+    hit.clear();
+    for (const collision::Contact &contact : broadphase.hash.gen_contacts()) {
+      // only worry about those that are still around and can flip
+      for (EntityHandle handle : {contact.a, contact.b}) {
+        OptEntity entity = EntityHelper::getEntityForHandle(handle);
+        if (entity && entity->has<HasVelocity>())
+          hit.push_back(entity.value());
+      }
+    }
+
+    // something touching two others still only flips once
+    std::sort(hit.begin(), hit.end());
+    hit.erase(std::unique(hit.begin(), hit.end()), hit.end());
+
+    for (Entity *entity : hit) {
+      HasVelocity &hasVel = entity->get<HasVelocity>();
+      hasVel.vel = hasVel.vel * -1.f;
+    }
   }
 };
 
+// raylib::RAYWHITE
+constexpr render_commands::RGBA entity_color = {245, 245, 245, 255};
+
 struct RenderEntities : System<Transform> {
+  render_commands::CommandBuffer *buffer = nullptr;
+
+  virtual void once(float) override {
+    buffer = render_commands::get_command_buffer();
+  }
 
   virtual void for_each_with(const Entity &, const Transform &transform,
                              float) const override {
-    raylib::DrawRectangleRec(transform.rect(), raylib::RAYWHITE);
+    if (!buffer)
+      return;
+    buffer->push_rect(transform.rect(), entity_color);
   }
 };
 
-void make_paddle(input::GamepadID id) {
+// `ai` is copied onto the paddle when set, each paddle gets its own rng
+void make_paddle(input::GamepadID id, const AIControlled *ai) {
   auto &entity = EntityHelper::createEntity();
 
   vec2 position = {.x = id == 0 ? 150.f : 1100.f, .y = 720.f / 2.f};
@@ -318,6 +480,10 @@ void make_paddle(input::GamepadID id) {
   entity.addComponent<PlayerID>(id);
   entity.addComponent<Transform>(position, vec2{30.f, 150.f});
   entity.addComponent<HasVelocity>();
+  if (ai) {
+    AIControlled &controlled = entity.addComponent<AIControlled>(*ai);
+    controlled.reseed(ai->rng + (uint32_t)id);
+  }
 }
 
 void make_ball() {
@@ -329,43 +495,45 @@ void make_ball() {
   entity.addComponent<HasVelocity>();
 }
 
-static void load_gamepad_mappings() {
-  std::ifstream ifs("gamecontrollerdb.txt");
-  if (!ifs.is_open()) {
-    std::cout << "Failed to load game controller db" << std::endl;
-    return;
-  }
-  std::stringstream buffer;
-  buffer << ifs.rdbuf();
-  input::set_gamepad_mappings(buffer.str().c_str());
-}
-
-int main(void) {
-  const int screenWidth = 1280;
-  const int screenHeight = 720;
-
-  raylib::InitWindow(screenWidth, screenHeight, "wm-afterhours");
-  raylib::SetTargetFPS(200);
-
-  load_gamepad_mappings();
-
+void make_world(bool ai_paddles, const AIControlled &ai = AIControlled{}) {
   // sophie
   {
     auto &entity = EntityHelper::createEntity();
     input::add_singleton_components<InputAction>(entity, get_mapping());
     window_manager::add_singleton_components(entity, 200);
+    collision::add_singleton_components(entity, 64.f);
+    render_commands::add_singleton_components(entity);
+    entity.addComponent<ProvidesScore>();
+    EntityHelper::registerSingleton<ProvidesScore>(entity);
   }
 
-  make_paddle(0);
-  make_paddle(1);
+  make_paddle(0, ai_paddles ? &ai : nullptr);
+  make_paddle(1, ai_paddles ? &ai : nullptr);
   make_ball();
 
-  SystemManager systems;
+  // the first hit can come whenever, so make room for everything that
+  // collides now instead of growing the broadphase mid match
+  collision::SpatialHash &hash =
+      EntityHelper::get_singleton_cmp<collision::ProvidesBroadphase>()->hash;
+  size_t colliders = 0;
+  size_t cells = 0;
+  for (const auto &entity : EntityHelper::get_entities()) {
+    if (!entity->has<Transform>())
+      continue;
+    const vec2 &size = entity->get<Transform>().size;
+    colliders++;
+    cells += hash.max_cells(size.x, size.y);
+  }
+  hash.reserve(colliders, cells, colliders * (colliders - 1) / 2);
+}
 
+void register_update_systems(SystemManager &systems) {
   // debug systems
   {
     window_manager::enforce_singletons(systems);
     input::enforce_singletons<InputAction>(systems);
+    collision::enforce_singletons(systems);
+    render_commands::enforce_singletons(systems);
   }
 
   // external plugins
@@ -374,10 +542,475 @@ int main(void) {
     window_manager::register_update_systems(systems);
   }
 
+  systems.register_update_system(std::make_unique<AIPaddleInput>());
   systems.register_update_system(std::make_unique<ImpulseBall>());
   systems.register_update_system(std::make_unique<ImpulsePaddle>());
   systems.register_update_system(std::make_unique<MoveAndBounce>());
+  collision::register_update_systems<Transform>(systems);
   systems.register_update_system(std::make_unique<Collide>());
+}
+
+// Records draw commands for everything, submitting them only does anything
+// when there is a window
+void register_entity_render_systems(SystemManager &systems) {
+  render_commands::register_begin_render_systems(systems);
+  systems.register_render_system(std::make_unique<RenderEntities>());
+  render_commands::register_render_systems(systems);
+}
+
+#if defined(PONG_HEADLESS)
+
+struct HeadlessOptions {
+  int matches = 1;
+  // one minute of play at 120hz
+  int ticks_per_match = 120 * 60;
+  float dt = 1.f / 120.f;
+  // writes <path>.json (chrome trace) and <path>.csv when set
+  std::string profile_path;
+  // also run the render systems every tick (records commands, draws nothing)
+  bool render = false;
+  // every tick, go back this many frames and play them again like rollback
+  // netplay would
+  int rollback = 0;
+  // host this many Worlds at once, each playing `matches` matches, spread
+  // over `threads` threads (0 plays everything on the default world)
+  int worlds = 0;
+  int threads = (int)std::thread::hardware_concurrency();
+  // with ALLOCS=1, ticks at the start of the last match that get to allocate
+  // while everything grows to size, after that any allocation is an error
+  int alloc_warmup = 1200;
+  // how sloppy the AI paddles are (see AIControlled), 0 and 0 never misses.
+  // every match gets its own seed starting from ai_seed
+  float ai_reaction = 0.1f;
+  float ai_aim_error = 40.f;
+  uint32_t ai_seed = 1;
+  // --help, print the flags and dont play
+  bool help = false;
+
+  [[nodiscard]] AIControlled ai_for(int match) const {
+    return AIControlled(ai_reaction, ai_aim_error, ai_seed + (uint32_t)match);
+  }
+};
+
+static void print_headless_usage(const char *program) {
+  std::cout << "usage: " << program << " [--flag value]...\n"
+            << "  --matches N         matches to play (1)\n"
+            << "  --ticks N           ticks per match (7200)\n"
+            << "  --dt SECONDS        time per tick (0.00833)\n"
+            << "  --profile PATH      write PATH.json and PATH.csv\n"
+            << "  --render 0|1        also run the render systems (0)\n"
+            << "  --rollback N        replay the last N frames every tick (0)\n"
+            << "  --worlds N          host N worlds at once (0)\n"
+            << "  --threads N         threads for --worlds (one per core)\n"
+            << "  --alloc-warmup N    ticks allowed to allocate (1200)\n"
+            << "  --ai-reaction S     seconds between AI retargets (0.1)\n"
+            << "  --ai-aim-error PX   how far off the AI can aim (40)\n"
+            << "  --ai-seed N         seed for the first match (1)\n"
+            << "  --help              print this" << std::endl;
+}
+
+// The whole argument or nothing, so `--matches 3x` is an error and not 3
+template <typename T> static bool parse_number(const char *text, T &out) {
+  try {
+    size_t used = 0;
+    T value;
+    if constexpr (std::is_same_v<T, float>) {
+      value = std::stof(text, &used);
+    } else if constexpr (std::is_same_v<T, uint32_t>) {
+      unsigned long wide = std::stoul(text, &used);
+      if (wide > std::numeric_limits<uint32_t>::max())
+        return false;
+      value = (uint32_t)wide;
+    } else {
+      value = std::stoi(text, &used);
+    }
+    if (text[used] != '\0')
+      return false;
+    out = value;
+    return true;
+  } catch (const std::logic_error &) {
+    // invalid_argument or out_of_range
+    return false;
+  }
+}
+
+// Returns false (after saying why) for an unknown flag, a flag missing its
+// value or a value that doesnt parse, a typo shouldnt quietly play
+// thousands of matches with the defaults
+static bool parse_headless_options(int argc, char **argv,
+                                   HeadlessOptions &options) {
+  for (int i = 1; i < argc; i++) {
+    std::string_view flag = argv[i];
+    if (flag == "--help" || flag == "-h") {
+      options.help = true;
+      continue;
+    }
+    bool has_value = i + 1 < argc;
+    const char *value = has_value ? argv[i + 1] : "";
+    auto number = [&](auto &out) {
+      return has_value && parse_number(value, out);
+    };
+
+    bool ok = false;
+    if (flag == "--matches") {
+      ok = number(options.matches);
+    } else if (flag == "--ticks") {
+      ok = number(options.ticks_per_match);
+    } else if (flag == "--dt") {
+      ok = number(options.dt);
+    } else if (flag == "--profile") {
+      ok = has_value;
+      options.profile_path = value;
+    } else if (flag == "--render") {
+      std::string_view on = value;
+      ok = on == "0" || on == "1";
+      options.render = on == "1";
+    } else if (flag == "--rollback") {
+      ok = number(options.rollback);
+    } else if (flag == "--worlds") {
+      ok = number(options.worlds);
+    } else if (flag == "--threads") {
+      ok = number(options.threads);
+    } else if (flag == "--alloc-warmup") {
+      ok = number(options.alloc_warmup);
+    } else if (flag == "--ai-reaction") {
+      ok = number(options.ai_reaction);
+    } else if (flag == "--ai-aim-error") {
+      ok = number(options.ai_aim_error);
+    } else if (flag == "--ai-seed") {
+      ok = number(options.ai_seed);
+    } else {
+      std::cout << "Unknown flag " << flag << std::endl;
+      return false;
+    }
+
+    if (!has_value) {
+      std::cout << flag << " needs a value" << std::endl;
+      return false;
+    }
+    if (!ok) {
+      std::cout << "Bad value for " << flag << ": " << value << std::endl;
+      return false;
+    }
+    // past the value
+    i++;
+  }
+  return true;
+}
+
+// Everything that changes during a match
+static void register_snapshot_components(SnapshotRing &snapshots) {
+  snapshots.register_component<Transform>();
+  snapshots.register_component<HasVelocity>();
+  snapshots.register_component<PlayerID>();
+  snapshots.register_component<AIControlled>();
+  snapshots.register_component<ProvidesScore>();
+}
+
+// Resimulating has to land exactly where we already were
+static double world_checksum() {
+  double sum = 0.0;
+  for (const auto &entity : EntityHelper::get_entities()) {
+    if (entity->has<Transform>()) {
+      const Transform &transform = entity->get<Transform>();
+      sum += transform.position.x + transform.position.y * 3.0;
+    }
+    if (entity->has<HasVelocity>()) {
+      const HasVelocity &vel = entity->get<HasVelocity>();
+      sum += vel.vel.x * 7.0 + vel.vel.y * 11.0;
+    }
+    if (entity->has<ProvidesScore>()) {
+      const ProvidesScore &score = entity->get<ProvidesScore>();
+      sum += score.left * 13.0 + score.right * 17.0;
+    }
+  }
+  return sum;
+}
+
+struct RollbackStats {
+  long long mismatches = 0;
+  std::vector<double> seconds;
+
+  [[nodiscard]] double percentile(double p) const {
+    std::vector<double> sorted = seconds;
+    std::sort(sorted.begin(), sorted.end());
+    return sorted[(size_t)(p * (double)(sorted.size() - 1))];
+  }
+};
+
+// Snapshot this frame, go back `frames`, and play them again (capturing each
+// one like we would when a late input shows up)
+static void rollback_and_resimulate(SystemManager &systems,
+                                    SnapshotRing &snapshots, uint64_t frame,
+                                    int frames, float dt,
+                                    RollbackStats &stats) {
+  auto start = std::chrono::steady_clock::now();
+  snapshots.capture(frame);
+  if (frame < (uint64_t)frames || !snapshots.has(frame - (uint64_t)frames))
+    return;
+  double expected = world_checksum();
+
+  uint64_t from = frame - (uint64_t)frames;
+  snapshots.restore(from);
+  for (uint64_t f = from + 1; f <= frame; f++) {
+    systems.tick_all(dt);
+    snapshots.capture(f);
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+  stats.seconds.push_back(seconds);
+  if (world_checksum() != expected)
+    stats.mismatches++;
+}
+
+#if defined(AFTER_HOURS_COUNT_ALLOCATIONS)
+// Prints every system that allocated since the counts were last reset,
+// returns how many allocations that was
+static uint64_t report_allocations(const SystemManager &systems,
+                                   int warmup) {
+  uint64_t total = 0;
+  auto report = [&](const SystemBase &system) {
+    uint64_t allocations = system.allocations;
+    if (allocations == 0)
+      return;
+    total += allocations;
+    std::cout << "  " << system.name << ": " << allocations
+              << " allocations, " << system.allocated_bytes << " bytes\n";
+  };
+  std::cout << "allocations in the last match after tick " << warmup
+            << ":\n";
+  for (const auto &system : systems.update_systems_)
+    report(*system);
+  for (const auto &system : systems.render_systems_)
+    report(*system);
+  std::cout << "  total " << total << std::endl;
+  return total;
+}
+#endif
+
+// Runs the update systems at a fixed dt as fast as we can with both paddles
+// played by AIPaddleInput, no window, nothing rendered
+static int run_headless(const HeadlessOptions &options) {
+  SystemManager systems;
+  register_update_systems(systems);
+  if (options.render)
+    register_entity_render_systems(systems);
+
+  SnapshotRing snapshots((size_t)options.rollback + 1);
+  register_snapshot_components(snapshots);
+  RollbackStats rollback_stats;
+  if (options.rollback > 0)
+    rollback_stats.seconds.reserve((size_t)options.matches *
+                                   (size_t)options.ticks_per_match);
+  uint64_t frame = 0;
+
+  long long total_ticks = 0;
+  long long entity_updates = 0;
+  long long left_points = 0;
+  long long right_points = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (int match = 0; match < options.matches; match++) {
+    EntityHelper::delete_all_entities(true);
+    make_world(true, options.ai_for(match));
+    // cant roll back into the last match
+    snapshots.clear();
+
+    for (int tick = 0; tick < options.ticks_per_match; tick++) {
+      if (options.rollback > 0)
+        rollback_and_resimulate(systems, snapshots, frame, options.rollback,
+                                options.dt, rollback_stats);
+      frame++;
+#if defined(AFTER_HOURS_COUNT_ALLOCATIONS)
+      // every match makes new entities whose vectors have to grow again,
+      // so only count the end of the last one
+      if (match == options.matches - 1 && tick == options.alloc_warmup)
+        systems.reset_allocation_counts();
+#endif
+      systems.tick_all(options.dt);
+      if (options.render)
+        systems.render_all(options.dt);
+      entity_updates += (long long)EntityHelper::get_entities().size();
+    }
+    total_ticks += options.ticks_per_match;
+
+    const ProvidesScore &score =
+        *EntityHelper::get_singleton_cmp<ProvidesScore>();
+    left_points += score.left;
+    right_points += score.right;
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  double seconds = std::chrono::duration<double>(end - start).count();
+  std::cout << "matches: " << options.matches << "\n"
+            << "ticks: " << total_ticks << " (dt " << options.dt << ")\n"
+            << "elapsed: " << seconds << "s\n"
+            << "ticks/sec: " << (double)total_ticks / seconds << "\n"
+            << "entities/sec: " << (double)entity_updates / seconds << "\n"
+            << "points left/right: " << left_points << "/" << right_points
+            << std::endl;
+
+  if (!rollback_stats.seconds.empty()) {
+    std::cout << "rollbacks: " << rollback_stats.seconds.size() << " of "
+              << options.rollback << " frames, snapshot + resimulate p50 "
+              << rollback_stats.percentile(0.5) * 1e6 << "us p99 "
+              << rollback_stats.percentile(0.99) * 1e6 << "us max "
+              << rollback_stats.percentile(1.0) * 1e6 << "us\n"
+              << "rollback mismatches: " << rollback_stats.mismatches
+              << std::endl;
+  }
+
+  if (options.render) {
+    const render_commands::CommandBuffer &buffer =
+        *render_commands::get_command_buffer();
+    std::cout << "draw commands last frame: " << buffer.recorded
+              << " recorded, " << buffer.commands.size() << " after merging, "
+              << buffer.batches.size() << " batches" << std::endl;
+  }
+
+#if defined(AFTER_HOURS_COUNT_ALLOCATIONS)
+  if (options.ticks_per_match > options.alloc_warmup &&
+      report_allocations(systems, options.alloc_warmup) > 0)
+    return 1;
+#endif
+
+  if (!options.profile_path.empty()) {
+#if defined(AFTER_HOURS_ENABLE_PROFILER)
+    std::ofstream trace(options.profile_path + ".json");
+    systems.profiler.write_chrome_trace(trace);
+    std::ofstream csv(options.profile_path + ".csv");
+    systems.profiler.write_csv(csv);
+    for (const std::string &line :
+         profiling::overlay_lines(systems.profiler)) {
+      std::cout << line << "\n";
+    }
+#else
+    std::cout << "--profile needs a build with PROFILE=1" << std::endl;
+#endif
+  }
+  return 0;
+}
+
+struct HostedWorldResult {
+  long long ticks = 0;
+  long long entity_updates = 0;
+  long long left_points = 0;
+  long long right_points = 0;
+};
+
+// Match host: every World has its own entities, singletons and systems so
+// the pool can tick as many of them at once as it has threads. A thread that
+// finishes its world grabs the next one
+static int run_match_host(const HeadlessOptions &options) {
+  std::vector<std::unique_ptr<World>> worlds;
+  for (int i = 0; i < options.worlds; i++) {
+    worlds.push_back(std::make_unique<World>());
+    WorldScope bound = worlds.back()->scope();
+    register_update_systems(worlds.back()->systems);
+  }
+  std::vector<HostedWorldResult> results(worlds.size());
+
+  ThreadPool pool((size_t)std::max(options.threads, 1));
+
+  auto start = std::chrono::steady_clock::now();
+  pool.parallel_for(worlds.size(), [&](size_t i) {
+    World &world = *worlds[i];
+    HostedWorldResult &result = results[i];
+    WorldScope bound = world.scope();
+    for (int match = 0; match < options.matches; match++) {
+      EntityHelper::delete_all_entities(true);
+      make_world(true, options.ai_for((int)i * options.matches + match));
+      for (int tick = 0; tick < options.ticks_per_match; tick++) {
+        world.systems.tick_all(options.dt);
+        result.entity_updates +=
+            (long long)EntityHelper::get_entities().size();
+      }
+      result.ticks += options.ticks_per_match;
+
+      const ProvidesScore &score =
+          *EntityHelper::get_singleton_cmp<ProvidesScore>();
+      result.left_points += score.left;
+      result.right_points += score.right;
+    }
+  });
+  auto end = std::chrono::steady_clock::now();
+
+  HostedWorldResult total;
+  for (const HostedWorldResult &result : results) {
+    total.ticks += result.ticks;
+    total.entity_updates += result.entity_updates;
+    total.left_points += result.left_points;
+    total.right_points += result.right_points;
+  }
+  long long matches = (long long)options.worlds * options.matches;
+
+  double seconds = std::chrono::duration<double>(end - start).count();
+  std::cout << "worlds: " << options.worlds << " on " << pool.size()
+            << " threads\n"
+            << "matches: " << matches << "\n"
+            << "ticks: " << total.ticks << " (dt " << options.dt << ")\n"
+            << "elapsed: " << seconds << "s\n"
+            << "matches/sec: " << (double)matches / seconds << "\n"
+            << "ticks/sec: " << (double)total.ticks / seconds << "\n"
+            << "entities/sec: " << (double)total.entity_updates / seconds
+            << "\n"
+            << "points left/right: " << total.left_points << "/"
+            << total.right_points << std::endl;
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  HeadlessOptions options;
+  if (!parse_headless_options(argc, argv, options)) {
+    print_headless_usage(argv[0]);
+    return 1;
+  }
+  if (options.help) {
+    print_headless_usage(argv[0]);
+    return 0;
+  }
+  if (options.worlds > 0)
+    return run_match_host(options);
+  return run_headless(options);
+}
+
+#else
+
+// Only indexes gamecontrollerdb.txt (or reads the index `make` wrote next to
+// it), the mapping for a gamepad gets registered once it connects. See
+// bench/gamepad_db.cpp for what that saves over loading all of it
+static gamepad_db::Database open_gamepad_db() {
+  auto start = std::chrono::steady_clock::now();
+  gamepad_db::Database db;
+  if (!db.open("gamecontrollerdb.txt", "gamecontrollerdb.idx")) {
+    std::cout << "Failed to load game controller db" << std::endl;
+    return db;
+  }
+  auto took = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start);
+  std::cout << "gamepad db: " << db.entries.size() << " mappings indexed in "
+            << took.count() << "us"
+            << (db.from_sidecar ? " (from gamecontrollerdb.idx)" : "")
+            << std::endl;
+  return db;
+}
+
+int main(void) {
+  const int screenWidth = 1280;
+  const int screenHeight = 720;
+
+  raylib::InitWindow(screenWidth, screenHeight, "wm-afterhours");
+  raylib::SetTargetFPS(200);
+
+  make_world(false);
+  gamepad_db::add_singleton_components(EntityHelper::createEntity(),
+                                       open_gamepad_db(), glfwGetJoystickGUID);
+
+  SystemManager systems;
+  gamepad_db::register_update_systems(systems);
+  register_update_systems(systems);
 
   // renders
   {
@@ -386,7 +1019,8 @@ int main(void) {
     systems.register_render_system(std::make_unique<RenderFPS>());
     // systems.register_render_system(
     // std::make_unique<input::RenderConnectedGamepads>());
-    systems.register_render_system(std::make_unique<RenderEntities>());
+    register_entity_render_systems(systems);
+    profiling::register_render_systems(systems);
   }
 
   while (!raylib::WindowShouldClose()) {
@@ -399,3 +1033,5 @@ int main(void) {
 
   return 0;
 }
+
+#endif
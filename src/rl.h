@@ -17,6 +17,9 @@
 #pragma GCC diagnostic ignored "-Wfloat-conversion"
 #endif
 
+#if defined(PONG_HEADLESS)
+#include "headless_rl.h"
+#else
 namespace raylib {
 #include "RaylibOpOverloads.h"
 #include "raylib.h"
@@ -24,6 +27,7 @@ namespace raylib {
 } // namespace raylib
 
 #include <GLFW/glfw3.h>
+#endif
 
 // We redefine the max here because the max keyboardkey is in the 300s
 #undef MAGIC_ENUM_RANGE_MAX
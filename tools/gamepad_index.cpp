@@ -0,0 +1,37 @@
+
+// Writes the GUID index for gamecontrollerdb.txt ahead of time so the game
+// can read it instead of scanning the text at startup (see
+// vendor/afterhours/src/plugins/gamepad_db.h). `make` runs it whenever the
+// db changes
+//
+//   ./gamepad_index.exe gamecontrollerdb.txt gamecontrollerdb.idx
+
+#include <iostream>
+
+#define AFTER_HOURS_ENTITY_HELPER
+#define AFTER_HOURS_SYSTEM
+#include "afterhours/ah.h"
+#include "afterhours/src/plugins/gamepad_db.h"
+
+using namespace afterhours;
+
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    std::cout << "usage: " << argv[0] << " gamecontrollerdb.txt out.idx"
+              << std::endl;
+    return 1;
+  }
+  gamepad_db::Database db;
+  if (!db.open(argv[1])) {
+    std::cout << "couldnt open " << argv[1] << std::endl;
+    return 1;
+  }
+  if (!db.write_index(argv[2])) {
+    std::cout << "couldnt write " << argv[2] << std::endl;
+    return 1;
+  }
+  std::cout << "indexed " << db.entries.size() << " "
+            << gamepad_db::current_platform() << " mappings into " << argv[2]
+            << std::endl;
+  return 0;
+}